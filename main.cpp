@@ -4,6 +4,8 @@
 
 #include <thread>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
 #include <iostream>
 
 
@@ -105,6 +107,54 @@ do_sync_thing() {
 } 
 
 
+void
+do_async_job(void *param) {
+	*(u64 *)param = do_async_thing();
+}
+
+void
+do_sync_job(void *param) {
+	*(u64 *)param = do_sync_thing();
+}
+
+void
+count_job(void *param) {
+	bg_atomic_fetch_add((volatile u64 *)param, 1);
+}
+
+u64
+compare_job_system_speed() {
+	u64 task_count = 10000;
+	volatile u64 counter = 0;
+
+	// what main used to do, a thread per task
+	u64 thread_start = bg_clock();
+	for (u64 i = 0; i < task_count; i += THREAD_COUNT) {
+		std::vector<std::thread> threads;
+		for (u64 k = 0; k < THREAD_COUNT; k++) {
+			threads.emplace_back([&counter]() { count_job((void *)&counter); });
+		}
+		for (auto &t : threads) {
+			t.join();
+		}
+	}
+	u64 thread_end = bg_clock();
+
+	u64 job_start = bg_clock();
+	Bg_Job *root = bg_job_create(NULL, NULL);
+	for_n (i, task_count) {
+		bg_job_run(bg_job_create(count_job, (void *)&counter, root));
+	}
+	bg_job_run(root);
+	bg_job_wait(root);
+	u64 job_end = bg_clock();
+
+	BG_ASSERT(counter == task_count * 2);
+	LOG_INFO("Running %llu tiny tasks on %u workers\nthread per task %.5f ms\njobs            %.5f ms\n", task_count, bg_job_worker_count(),
+		to_ms(thread_end - thread_start), to_ms(job_end - job_start));
+	return counter;
+}
+
 u64
 compare_conversion_speed() {
 	s64 result = 0;
@@ -145,6 +195,945 @@ compare_conversion_speed() {
 
 }
 
+u64
+check_inline_array() {
+	// stays in its buffer, spills past N, and comes back to the buffer after arrfree even though N < 8
+	Inline_Array<u32, 4> arr;
+	u64 result = 0;
+	for_n (round, 2) {
+		for_n (i, 4) {
+			arrput(&arr, (u32)i);
+		}
+		BG_ASSERT((void *)arr.data == (void *)arr.inline_storage && arr.cap == 4);
+		arrput(&arr, 4u);
+		BG_ASSERT((void *)arr.data != (void *)arr.inline_storage);
+		for_array (i, arr) {
+			result += arr[i];
+		}
+		arrfree(&arr);
+	}
+	arrput(&arr, 1u);
+	BG_ASSERT((void *)arr.data == (void *)arr.inline_storage);
+	arrfree(&arr);
+	LOG_INFO("Inline_Array round trips ok, sum %llu\n", result);
+	return result;
+}
+
+u64
+compare_array_push_speed() {
+	u64 push_count = 1000ull * 1000ull * 100ull; // 10^8, directory listings easily hit millions
+	u64 result = 0;
+
+	u64 bg_start = bg_clock();
+	{
+		Array<u32> arr = {};
+		for (u64 i = 0; i < push_count; i++) {
+			arrput(&arr, (u32)i);
+		}
+		result += arr.len + arr.data[push_count / 2];
+		arrfree(&arr);
+	}
+	u64 bg_end = bg_clock();
+
+	u64 std_start = bg_clock();
+	{
+		std::vector<u32> vec;
+		for (u64 i = 0; i < push_count; i++) {
+			vec.push_back((u32)i);
+		}
+		result += vec.size() + vec[push_count / 2];
+	}
+	u64 std_end = bg_clock();
+
+	double bg_ms  = to_ms(bg_end - bg_start);
+	double std_ms = to_ms(std_end - std_start);
+	LOG_INFO("Pushing %llu elements\narrput    %.5f ms\npush_back %.5f ms\n", push_count, bg_ms, std_ms);
+	return result;
+}
+
+int
+compare_u64_for_qsort(const void *a, const void *b) {
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+	return (x > y) - (x < y);
+}
+
+u64
+compare_sort_speed() {
+	u64 count = 1000ull * 1000ull * 10ull;
+	u64 *source = (u64 *)bg_malloc(count * sizeof(u64));
+	u64 *work   = (u64 *)bg_malloc(count * sizeof(u64));
+	defer({free(source); free(work);});
+
+	// scratch for stable & radix sorts
+	u64 arena_size = count * sizeof(u64) + Megabyte(1);
+	void *arena_memory = bg_malloc(arena_size);
+	defer({free(arena_memory);});
+	Linear_Allocator arena = init_linear_allocator(arena_memory, arena_size, 16);
+
+	Bg_Random_State rng = bg_init_random(535);
+	for_n (i, count) {
+		source[i] = (bg_random(&rng) << 32) | bg_random(&rng); // inode like keys
+	}
+
+	u64 start = 0;
+	double ms[5] = {};
+
+	copy_memory(work, source, count * sizeof(u64));
+	start = bg_clock();
+	qsort(work, count, sizeof(u64), compare_u64_for_qsort);
+	ms[0] = to_ms(bg_clock() - start);
+
+	copy_memory(work, source, count * sizeof(u64));
+	start = bg_clock();
+	std::sort(work, work + count);
+	ms[1] = to_ms(bg_clock() - start);
+
+	Slice<u64> slice = {work, count};
+	copy_memory(work, source, count * sizeof(u64));
+	start = bg_clock();
+	bg_sort(slice);
+	ms[2] = to_ms(bg_clock() - start);
+
+	copy_memory(work, source, count * sizeof(u64));
+	start = bg_clock();
+	bg_stable_sort(slice, &arena);
+	ms[3] = to_ms(bg_clock() - start);
+
+	copy_memory(work, source, count * sizeof(u64));
+	start = bg_clock();
+	bg_radix_sort(slice, &arena);
+	ms[4] = to_ms(bg_clock() - start);
+
+	for (u64 i = 1; i < count; i++) {
+		BG_ASSERT(work[i - 1] <= work[i]);
+	}
+
+	LOG_INFO("Sorting %llu u64\nqsort          %.5f ms\nstd::sort      %.5f ms\nbg_sort        %.5f ms\nbg_stable_sort %.5f ms\nbg_radix_sort  %.5f ms\n", count, ms[0], ms[1], ms[2], ms[3], ms[4]);
+	return work[count / 2];
+}
+
+u64
+compare_parallel_speed() {
+	u64 count = 1000ull * 1000ull * 100ull; // manifest sized
+	u32 *entries = (u32 *)bg_malloc(count * sizeof(u32));
+	defer({free(entries);});
+	Slice<u32> slice = {entries, count};
+
+	u64 start = 0;
+	double serial_for = 0, parallel_for_ms = 0;
+	double serial_reduce = 0, parallel_reduce_ms = 0;
+	double serial_sort = 0, parallel_sort_ms = 0;
+
+	start = bg_clock();
+	for_n (i, count) {
+		entries[i] = (u32)(i * 2654435761u);
+	}
+	serial_for = to_ms(bg_clock() - start);
+
+	start = bg_clock();
+	parallel_for(slice, 0, [](u32 &e, u64 i) {
+		e = (u32)(i * 2654435761u);
+	});
+	parallel_for_ms = to_ms(bg_clock() - start);
+
+	u64 serial_sum = 0;
+	start = bg_clock();
+	for_n (i, count) {
+		serial_sum += entries[i];
+	}
+	serial_reduce = to_ms(bg_clock() - start);
+
+	start = bg_clock();
+	u64 parallel_sum = parallel_reduce(slice, (u64)0, [](u64 acc, u32 e) { return acc + e; }, [](u64 a, u64 b) { return a + b; });
+	parallel_reduce_ms = to_ms(bg_clock() - start);
+	BG_ASSERT(serial_sum == parallel_sum);
+
+	Slice<u32> sort_slice = {entries, count / 5};
+	start = bg_clock();
+	bg_sort(sort_slice);
+	serial_sort = to_ms(bg_clock() - start);
+
+	parallel_for(sort_slice, 0, [](u32 &e, u64 i) {
+		e = (u32)(i * 2654435761u);
+	});
+	start = bg_clock();
+	parallel_sort(sort_slice);
+	parallel_sort_ms = to_ms(bg_clock() - start);
+
+	LOG_INFO("Parallel algorithms on %u threads, %llu entries\nfor    serial %.5f ms, parallel %.5f ms\nreduce serial %.5f ms, parallel %.5f ms\nsort(%llu) serial %.5f ms, parallel %.5f ms\n",
+		bg_parallel_worker_count() + 1, count, serial_for, parallel_for_ms, serial_reduce, parallel_reduce_ms, sort_slice.len, serial_sort, parallel_sort_ms);
+	return serial_sum;
+}
+
+u64
+compare_lock_contention() {
+	u64 op_count = 1000ull * 1000ull * 4ull;
+	u64 result = 0;
+
+	for (u64 thread_count = 1; thread_count <= 8; thread_count *= 2) {
+		u64 per_thread = op_count / thread_count;
+		double ms[4] = {};
+
+		// short critical section, like appending a log line or bumping a stat
+		{
+			Mutex mutex = init_mutex();
+			u64 counter = 0;
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					for_n (i, per_thread) {
+						lock_mutex(&mutex);
+						counter++;
+						unlock_mutex(&mutex);
+					}
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[0] = to_ms(bg_clock() - start);
+			free_mutex(&mutex);
+			result += counter;
+		}
+		{
+			Fast_Mutex mutex = init_fast_mutex();
+			u64 counter = 0;
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					for_n (i, per_thread) {
+						lock_fast_mutex(&mutex);
+						counter++;
+						unlock_fast_mutex(&mutex);
+					}
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[1] = to_ms(bg_clock() - start);
+			result += counter;
+		}
+
+		// read mostly, 1 write per 64 reads, like config & catalog caches
+		u64 table[16] = {};
+		{
+			Mutex mutex = init_mutex();
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					u64 sum = 0;
+					for_n (i, per_thread) {
+						lock_mutex(&mutex);
+						if ((i & 63) == 0)
+							table[i & 15]++;
+						else
+							sum += table[i & 15];
+						unlock_mutex(&mutex);
+					}
+					volatile u64 keep = sum; // so reads aren't optimized away
+					(void)keep;
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[2] = to_ms(bg_clock() - start);
+			free_mutex(&mutex);
+		}
+		{
+			RW_Mutex mutex = init_rw_mutex();
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					u64 sum = 0;
+					for_n (i, per_thread) {
+						if ((i & 63) == 0) {
+							lock_write_rw_mutex(&mutex);
+							table[i & 15]++;
+							unlock_write_rw_mutex(&mutex);
+						}
+						else {
+							lock_read_rw_mutex(&mutex);
+							sum += table[i & 15];
+							unlock_read_rw_mutex(&mutex);
+						}
+					}
+					volatile u64 keep = sum; // so reads aren't optimized away
+					(void)keep;
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[3] = to_ms(bg_clock() - start);
+		}
+
+		LOG_INFO("%llu threads, %llu lock/unlock\nMutex      %.5f ms\nFast_Mutex %.5f ms\nread mostly Mutex    %.5f ms\nread mostly RW_Mutex %.5f ms\n",
+			thread_count, per_thread * thread_count, ms[0], ms[1], ms[2], ms[3]);
+	}
+	return result;
+}
+
+u64
+compare_spsc_ring_speed() {
+	u64 item_count = 1000ull * 1000ull * 20ull;
+	u64 result = 0;
+
+	// what reader -> compressor handoff used to look like
+	u64 mutex_start = bg_clock();
+	{
+		Array<u64> shared = {};
+		Mutex mutex = init_mutex();
+		volatile bool done = false;
+		std::thread producer([&]() {
+			for (u64 i = 0; i < item_count; i++) {
+				lock_mutex(&mutex);
+				arrput(&shared, i);
+				unlock_mutex(&mutex);
+			}
+			lock_mutex(&mutex);
+			done = true;
+			unlock_mutex(&mutex);
+		});
+
+		Array<u64> local = {};
+		for (;;) {
+			lock_mutex(&mutex);
+			bool finished = done;
+			Array<u64> tmp = shared;
+			shared = local;
+			unlock_mutex(&mutex);
+			local = tmp;
+
+			for_array(i, local) {
+				result += local[i];
+			}
+			local.len = 0;
+			if (finished && shared.len == 0)
+				break;
+		}
+		producer.join();
+		arrfree(&local);
+		arrfree(&shared);
+		free_mutex(&mutex);
+	}
+	u64 mutex_end = bg_clock();
+
+	u64 spsc_start = bg_clock();
+	{
+		Spsc_Ring<u64> ring = {};
+		spsc_init(&ring, 4096);
+		std::thread producer([&]() {
+			u64 batch[64];
+			for (u64 i = 0; i < item_count; i += 64) {
+				u64 n = BG_MIN(64, item_count - i);
+				for_n(k, n) {
+					batch[k] = i + k;
+				}
+				spsc_push_n(&ring, batch, n);
+			}
+			spsc_close(&ring);
+		});
+
+		u64 batch[64];
+		u64 n = 0;
+		while ((n = spsc_pop_n(&ring, batch, 64))) {
+			for_n(k, n) {
+				result -= batch[k];
+			}
+		}
+		producer.join();
+		spsc_free(&ring);
+	}
+	u64 spsc_end = bg_clock();
+
+	BG_ASSERT(result == 0);
+	LOG_INFO("Handing %llu items to other thread\nArray + Mutex %.5f ms\nSpsc_Ring     %.5f ms\n", item_count, to_ms(mutex_end - mutex_start), to_ms(spsc_end - spsc_start));
+	return result;
+}
+
+u64
+measure_mpmc_queue_throughput() {
+	u64 item_count = 1ull << 22;
+	u64 result = 0;
+
+	for (u64 thread_count = 1; thread_count <= 64; thread_count *= 2) {
+		Mpmc_Queue<u64> queue = {};
+		mpmc_init(&queue, 1024);
+
+		u64 per_thread = item_count / thread_count;
+		std::vector<u64> sums(thread_count);
+		std::vector<std::thread> threads;
+
+		u64 start = bg_clock();
+		for_n (t, thread_count) {
+			threads.emplace_back([&, t]() {
+				for_n (i, per_thread) {
+					mpmc_push(&queue, t * per_thread + i);
+				}
+			});
+			threads.emplace_back([&, t]() {
+				u64 sum = 0;
+				u64 v = 0;
+				for_n (i, per_thread) {
+					mpmc_pop(&queue, &v);
+					sum += v;
+				}
+				sums[t] = sum;
+			});
+		}
+		for (auto &t : threads) {
+			t.join();
+		}
+		u64 end = bg_clock();
+
+		u64 total = 0;
+		for (u64 s : sums) {
+			total += s;
+		}
+		u64 n = per_thread * thread_count;
+		BG_ASSERT(total == n * (n - 1) / 2);
+		result += total;
+
+		double ms = to_ms(end - start);
+		LOG_INFO("Mpmc_Queue %2llu producers %2llu consumers, %llu items %.5f ms, %.2f M items/s\n", thread_count, thread_count, n, ms, (double)n / (ms * 1000.0));
+		mpmc_free(&queue);
+	}
+	return result;
+}
+
+u64
+compare_hash_speed() {
+	u64 bfsize = Megabyte(256);
+	u8 *bf     = (u8 *)bg_malloc(bfsize);
+	defer({free(bf);});
+
+	for (u64 i = 0; i < bfsize / 8; i++) {
+		((u64 *)bf)[i] = i * 23 - 535;
+	}
+
+	u64 crc_start = bg_clock();
+	u32 crc = bg_crc32(bf, bfsize);
+	u64 crc_end = bg_clock();
+
+	u64 h64_start = bg_clock();
+	u64 h64 = bg_hash64(bf, bfsize);
+	u64 h64_end = bg_clock();
+
+	u64 h128_start = bg_clock();
+	Bg_Hash128 h128 = bg_hash128(bf, bfsize);
+	u64 h128_end = bg_clock();
+
+	// same as reading a file block by block
+	u64 stream_start = bg_clock();
+	Bg_Hash_Stream hs = bg_init_hash_stream(0);
+	for (u64 i = 0; i < bfsize; i += Megabyte(1)) {
+		bg_hash_stream_update(&hs, bf + i, Megabyte(1));
+	}
+	u64 stream = bg_hash_stream_final(&hs);
+	u64 stream_end = bg_clock();
+	BG_ASSERT(stream == h64);
+
+	double gb = (double)bfsize / (double)Gigabyte(1);
+	LOG_INFO("Hashing %llu MB\ncrc32   %.3f GB/s\nhash64  %.3f GB/s\nhash128 %.3f GB/s\nstream  %.3f GB/s\n", bfsize / Megabyte(1),
+		gb / (to_ms(crc_end - crc_start) / 1000.0), gb / (to_ms(h64_end - h64_start) / 1000.0),
+		gb / (to_ms(h128_end - h128_start) / 1000.0), gb / (to_ms(stream_end - stream_start) / 1000.0));
+	return crc + h64 + h128.lo + stream;
+}
+
+u64
+compare_hash_map_speed() {
+	u64 key_count = 1000ull * 1000ull * 4ull;
+	u64 result = 0;
+
+	Array<u64> keys = {};
+	arrreserve(&keys, key_count);
+	Bg_Random_State rs = bg_init_random(bg_clock());
+	for (u64 i = 0; i < key_count; i++) {
+		arrput(&keys, (bg_random(&rs) << 32) | bg_random(&rs));
+	}
+	defer({arrfree(&keys);});
+
+	u64 bg_insert_start = bg_clock();
+	Hash_Map<u64, u64> map = {};
+	for_array (i, keys) {
+		hmput(&map, keys[i], i);
+	}
+	u64 bg_insert_end = bg_clock();
+
+	u64 bg_lookup_start = bg_clock();
+	for_array (i, keys) {
+		result += *hmget(&map, keys[i]);
+	}
+	u64 bg_lookup_end = bg_clock();
+
+	u64 bg_iterate_start = bg_clock();
+	for_array (i, map.entries) {
+		result += map.entries[i].value;
+	}
+	u64 bg_iterate_end = bg_clock();
+	hmfree(&map);
+
+	u64 std_insert_start = bg_clock();
+	std::unordered_map<u64, u64> std_map;
+	for_array (i, keys) {
+		std_map[keys[i]] = i;
+	}
+	u64 std_insert_end = bg_clock();
+
+	u64 std_lookup_start = bg_clock();
+	for_array (i, keys) {
+		result += std_map.find(keys[i])->second;
+	}
+	u64 std_lookup_end = bg_clock();
+
+	u64 std_iterate_start = bg_clock();
+	for (auto &kv : std_map) {
+		result += kv.second;
+	}
+	u64 std_iterate_end = bg_clock();
+
+	LOG_INFO("Hash map with %llu keys\ninsert  bg %.5f ms, std %.5f ms\nlookup  bg %.5f ms, std %.5f ms\niterate bg %.5f ms, std %.5f ms\n", key_count,
+		to_ms(bg_insert_end - bg_insert_start), to_ms(std_insert_end - std_insert_start),
+		to_ms(bg_lookup_end - bg_lookup_start), to_ms(std_lookup_end - std_lookup_start),
+		to_ms(bg_iterate_end - bg_iterate_start), to_ms(std_iterate_end - std_iterate_start));
+	return result;
+}
+
+#if BG_HAS_COROUTINES
+Bg_Task
+copy_lane(Io_Executor *ex, File *src, File *dst, u64 block_size, u64 lane, u64 lane_count, u64 block_count, u8 *buffer, u64 *hash) {
+	for (u64 b = lane; b < block_count; b += lane_count) {
+		s64 offset = (s64)(b * block_size);
+		s64 n = co_await co_read_file(ex, src, buffer, block_size, offset);
+		if (n <= 0)
+			break;
+		*hash ^= bg_hash64(buffer, (u64)n);
+		co_await co_write_file(ex, dst, buffer, (u64)n, offset);
+	}
+}
+
+u64
+compare_async_file_io() {
+	const u64 block_size = 256 * 1024;
+	const u64 block_count = 256;
+	const u64 lane_count = 16;
+
+	u8 *data = (u8 *)bg_malloc(block_size * block_count);
+	for_n (i, block_size * block_count) {
+		data[i] = (u8)(i * 2654435761u >> 13);
+	}
+	dump_file((char *)"async_io_src.bin", data, block_size * block_count);
+
+	u64 sync_hash = 0, async_hash = 0;
+	double ms[2] = {};
+
+	// read block, hash, write, one at a time
+	{
+		delete_file("async_io_dst.bin");
+		File src = open_file("async_io_src.bin");
+		File dst = create_file("async_io_dst.bin");
+		u64 start = bg_clock();
+		for_n (b, block_count) {
+			s64 n = read_file_at(&src, data, block_size, (s64)(b * block_size));
+			sync_hash ^= bg_hash64(data, (u64)n);
+			write_file_at(&dst, data, (u64)n, (s64)(b * block_size));
+		}
+		ms[0] = to_ms(bg_clock() - start);
+		close_file(&src);
+		close_file(&dst);
+	}
+
+	// same pipeline written sequentially in coroutines, lane_count blocks in flight
+	{
+		delete_file("async_io_dst.bin");
+		File src = open_file("async_io_src.bin");
+		File dst = create_file("async_io_dst.bin");
+		Io_Executor ex;
+		io_executor_init(&ex, 8);
+		u64 lane_hash[lane_count] = {};
+		u64 start = bg_clock();
+		for_n (l, lane_count) {
+			io_executor_spawn(&ex, copy_lane(&ex, &src, &dst, block_size, l, lane_count, block_count, data + l * block_size, &lane_hash[l]));
+		}
+		io_executor_run(&ex);
+		ms[1] = to_ms(bg_clock() - start);
+		io_executor_free(&ex);
+		for_n (l, lane_count) {
+			async_hash ^= lane_hash[l];
+		}
+		close_file(&src);
+		close_file(&dst);
+	}
+	BG_ASSERT(sync_hash == async_hash);
+
+	delete_file("async_io_src.bin");
+	delete_file("async_io_dst.bin");
+	bg_free(data);
+
+	LOG_INFO("Read, hash, write %llu blocks of %llu KB\nsequential %.5f ms\ncoroutines %.5f ms (%llu in flight)\n",
+		block_count, block_size / 1024, ms[0], ms[1], lane_count);
+	return sync_hash;
+}
+#endif
+
+u64
+compare_counter_contention() {
+	u64 op_count = 1000ull * 1000ull * 8ull;
+	u64 result = 0;
+
+	for (u64 thread_count = 1; thread_count <= 8; thread_count *= 2) {
+		u64 per_thread = op_count / thread_count;
+		double ms[3] = {};
+
+		// every thread bumps same stat, like bytes written or log lines
+		{
+			Fast_Mutex mutex = init_fast_mutex();
+			u64 counter = 0;
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					for_n (i, per_thread) {
+						lock_fast_mutex(&mutex);
+						counter++;
+						unlock_fast_mutex(&mutex);
+					}
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[0] = to_ms(bg_clock() - start);
+			result += counter;
+		}
+		{
+			volatile u64 counter = 0;
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					for_n (i, per_thread) {
+						bg_atomic_fetch_add(&counter, 1, BG_RELAXED);
+					}
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[1] = to_ms(bg_clock() - start);
+			result += counter;
+		}
+		{
+			static Sharded_Counter counter;
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&]() {
+					for_n (i, per_thread) {
+						sharded_counter_add(&counter);
+					}
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[2] = to_ms(bg_clock() - start);
+			result += sharded_counter_read(&counter);
+		}
+
+		LOG_INFO("Counter with %llu threads, %llu increments\nfast mutex %.5f ms\natomic add %.5f ms\nsharded    %.5f ms\n",
+			thread_count, op_count, ms[0], ms[1], ms[2]);
+	}
+	return result;
+}
+
+void
+count_timer(void *param) {
+	(*(u64 *)param)++;
+}
+
+struct Timer_Cancel_Case {
+	Timer_Wheel *wheel;
+	Bg_Timer    *other;
+	u64         *fired;
+};
+
+void
+cancel_other_timer(void *param) {
+	Timer_Cancel_Case *c = (Timer_Cancel_Case *)param;
+	(*c->fired)++;
+	timer_wheel_cancel(c->wheel, c->other);
+}
+
+u64
+measure_timer_wheel() {
+	const u64 timer_count = 1000ull * 1000ull;
+	Bg_Timer *timers = (Bg_Timer *)bg_calloc(timer_count, sizeof(Bg_Timer));
+	Timer_Wheel wheel;
+	timer_wheel_init(&wheel, 1);
+	u64 fired = 0;
+
+	// spread over every level, like io timeouts & retry backoffs
+	u64 start = bg_clock();
+	for_n (i, timer_count) {
+		timer_wheel_add(&wheel, &timers[i], (u32)((i * 2654435761u) % (3600u * 1000u)), count_timer, &fired);
+	}
+	double add_ms = to_ms(bg_clock() - start);
+
+	// most timeouts never fire, they're cancelled when io completes
+	start = bg_clock();
+	for (u64 i = 0; i < timer_count; i += 2) {
+		timer_wheel_cancel(&wheel, &timers[i]);
+	}
+	double cancel_ms = to_ms(bg_clock() - start);
+
+	start = bg_clock();
+	timer_wheel_poll(&wheel);
+	double poll_ms = to_ms(bg_clock() - start);
+
+	timer_wheel_free(&wheel);
+	bg_free(timers);
+
+	// two timers due in the same poll, whichever runs first cancels the other while it sits on expired list.
+	// third one must still fire, wheel used to lose count of it and sleep forever.
+	{
+		Bg_Timer pair[2] = {};
+		Bg_Timer later   = {};
+		u64 pair_fired   = 0;
+		u64 later_fired  = 0;
+		timer_wheel_init(&wheel, 1);
+		Timer_Cancel_Case cases[2] = {{&wheel, &pair[1], &pair_fired}, {&wheel, &pair[0], &pair_fired}};
+		timer_wheel_add(&wheel, &pair[0], 1, cancel_other_timer, &cases[0]);
+		timer_wheel_add(&wheel, &pair[1], 1, cancel_other_timer, &cases[1]);
+		timer_wheel_add(&wheel, &later, 20, count_timer, &later_fired);
+		u64 wait_start = bg_clock();
+		while (later_fired == 0 && to_ms(bg_clock() - wait_start) < 1000.0) {
+			timer_wheel_poll(&wheel);
+			BG_ASSERT(later_fired || timer_wheel_ms_until_next(&wheel) != BG_WAIT_INFINITE);
+		}
+		BG_ASSERT(pair_fired == 1 && later_fired == 1);
+		timer_wheel_free(&wheel);
+		fired += pair_fired + later_fired;
+	}
+
+	LOG_INFO("Timer wheel, %llu timers\nadd    %.2f ns/op\ncancel %.2f ns/op\npoll   %.5f ms\n",
+		timer_count, add_ms * 1000000.0 / (double)timer_count, cancel_ms * 1000000.0 / (double)(timer_count / 2), poll_ms);
+	return fired;
+}
+
+void
+print_cpu_topology() {
+	Bg_Cpu_Topology topology;
+	bg_get_cpu_topology(&topology);
+	LOG_INFO("%u cpus, %u cores, %u packages\n", topology.cpu_count, topology.core_count, topology.package_count);
+	for_n (i, topology.cpu_count) {
+		Bg_Cpu *cpu = &topology.cpus[i];
+		LOG_INFO("cpu %u package %u core %u smt %u l2 group %u l3 group %u\n", cpu->id, cpu->package, cpu->core, cpu->smt_index, cpu->l2_group, cpu->l3_group);
+	}
+}
+
+u64
+compare_wake_latency() {
+	u64 result = 0;
+	double ms[3] = {};
+
+	// uncontended signal & wait, never leaves user mode
+	u64 op_count = 1000ull * 1000ull * 10ull;
+	{
+		Semaphore sem = init_semaphore(0);
+		u64 start = bg_clock();
+		for_n (i, op_count) {
+			post_semaphore(&sem);
+			wait_semaphore(&sem);
+		}
+		ms[0] = to_ms(bg_clock() - start);
+	}
+
+	// ping pong between 2 threads, waiter sleeps on futex until signaled
+	u64 round_trips = 2000;
+	{
+		Semaphore ping = init_semaphore(0), pong = init_semaphore(0);
+		u64 start = bg_clock();
+		std::thread t([&]() {
+			for_n (i, round_trips) {
+				wait_semaphore(&ping);
+				post_semaphore(&pong);
+			}
+		});
+		for_n (i, round_trips) {
+			post_semaphore(&ping);
+			wait_semaphore(&pong);
+			result++;
+		}
+		t.join();
+		ms[1] = to_ms(bg_clock() - start);
+	}
+
+	// same with polling a flag and Sleep(1) in between, what staggered code did before
+	{
+		volatile u32 turn = 0;
+		u64 polled_trips = round_trips / 20;
+		u64 start = bg_clock();
+		std::thread t([&]() {
+			for_n (i, polled_trips) {
+				while (bg_atomic_load(&turn, BG_ACQUIRE) != 1)
+					Sleep(1);
+				bg_atomic_store(&turn, 0, BG_RELEASE);
+			}
+		});
+		for_n (i, polled_trips) {
+			bg_atomic_store(&turn, 1, BG_RELEASE);
+			while (bg_atomic_load(&turn, BG_ACQUIRE) != 0)
+				Sleep(1);
+			result++;
+		}
+		t.join();
+		ms[2] = to_ms(bg_clock() - start) * 20.0;
+	}
+
+	LOG_INFO("Wake latency\nuncontended post+wait %.2f ns/op\nsemaphore ping pong %.3f us/round trip\nSleep(1) polling %.3f us/round trip\n",
+		ms[0] * 1000000.0 / (double)op_count, ms[1] * 1000.0 / (double)round_trips, ms[2] * 1000.0 / (double)round_trips);
+	return result;
+}
+
+u64
+compare_log_speed() {
+	const u64 line_count = 100ull * 1000ull;
+	u64 result = 0;
+
+	for (u64 thread_count = 1; thread_count <= 4; thread_count *= 4) {
+		u64 per_thread = line_count / thread_count;
+		double ms[3] = {};
+
+		// sync, async. ms[2] is async plus time until it's all on disk
+		for_n (mode, 2) {
+			if (mode == 1)
+				bg_init_async_log(Bg_Log_Full_Policy_Block);
+			std::vector<std::thread> threads;
+			u64 start = bg_clock();
+			for_n (t, thread_count) {
+				threads.emplace_back([&, t]() {
+					for_n (i, per_thread) {
+						LOG_DEBUG("log speed thread %llu line %llu value %f", t, i, (double)i * 0.5);
+					}
+				});
+			}
+			for (auto &t : threads) {
+				t.join();
+			}
+			ms[mode] = to_ms(bg_clock() - start);
+			if (mode == 1) {
+				bg_flush_log();
+				ms[2] = to_ms(bg_clock() - start);
+				bg_stop_async_log();
+			}
+		}
+		result += bg_get_stats().log_line_count;
+
+		LOG_INFO("Log %llu lines from %llu threads\nsync          %.5f ms (%.1f ns/line)\nasync         %.5f ms (%.1f ns/line)\nasync+flushed %.5f ms\n",
+			line_count, thread_count, ms[0], ms[0] * 1e6 / line_count, ms[1], ms[1] * 1e6 / line_count, ms[2]);
+	}
+	return result;
+}
+
+u64
+measure_filtered_log() {
+	const u64 line_count = 10ull * 1000ull * 1000ull;
+	u64 evaluated = 0;
+
+	// debug lines left in hot loops, filtered at runtime
+	bg_set_log_level(BG_LOG_LEVEL_INFO);
+	u64 start = bg_clock();
+	for_n (i, line_count) {
+		LOG_DEBUG("filtered line %llu, %llu", i, ++evaluated);
+	}
+	double ms = to_ms(bg_clock() - start);
+	bg_set_log_level(BG_LOG_LEVEL_DEBUG);
+
+	// error in a retry loop, first few go through, rest are counted
+	start = bg_clock();
+	for_n (i, line_count) {
+		LOG_RATE_LIMITED(10, 1000, LOG_INFO, "rate limited line %llu\n", i);
+	}
+	double limited_ms = to_ms(bg_clock() - start);
+
+	LOG_INFO("%llu filtered debug lines %.5f ms (%.2f ns/line), %llu arguments evaluated\nrate limited lines %.5f ms (%.2f ns/line)\n",
+		line_count, ms, ms * 1e6 / line_count, evaluated, limited_ms, limited_ms * 1e6 / line_count);
+	return evaluated;
+}
+
+u64
+compare_binary_log_speed() {
+	// bursts fit in thread's ring, so this is callsite cost alone. writer drains between bursts, untimed.
+	const u64 burst = 1000;
+	const u64 burst_count = 100;
+	const u64 line_count = burst * burst_count;
+	double ms[4] = {};
+
+	bg_init_async_log(Bg_Log_Full_Policy_Block);
+	for_n (mode, 3) {
+		// text, binary formatted by writer, binary written to file as is
+		if (mode == 2)
+			bg_open_binary_log("binary_log.bin");
+		for_n (b, burst_count) {
+			u64 start = bg_clock();
+			for_n (i, burst) {
+				if (mode == 0) {
+					LOG_INFO("request %llu took %.3f ms, status %s", i, (double)i * 0.01, "ok");
+				}
+				else {
+					LOGB_INFO("request %llu took %.3f ms, status %s", i, (double)i * 0.01, "ok");
+				}
+			}
+			ms[mode] += to_ms(bg_clock() - start);
+			bg_flush_log();
+		}
+	}
+	bg_close_binary_log();
+	bg_stop_async_log();
+
+	u64 start = bg_clock();
+	bg_render_binary_log("binary_log.bin", "binary_log.txt");
+	ms[3] = to_ms(bg_clock() - start);
+
+	LOG_INFO("%llu async log lines, callsite cost\ntext             %.5f ms (%.1f ns/line)\nbinary           %.5f ms (%.1f ns/line)\nbinary to file   %.5f ms (%.1f ns/line)\nrender offline   %.5f ms\n",
+		line_count, ms[0], ms[0] * 1e6 / line_count, ms[1], ms[1] * 1e6 / line_count, ms[2], ms[2] * 1e6 / line_count, ms[3]);
+	delete_file("binary_log.bin");
+	delete_file("binary_log.txt");
+	return line_count;
+}
+
+u64
+compare_timestamp_speed() {
+	// what each log line used to pay for its date vs the coarse clock the prefix cache runs on
+	const u64 count = 1000000;
+	u64 sum = 0;
+
+	u64 start = bg_clock();
+	for_n (i, count) {
+		Bg_Date d = get_local_date();
+		sum += d.millisecond;
+	}
+	double date_ms = to_ms(bg_clock() - start);
+
+	start = bg_clock();
+	for_n (i, count) {
+		sum += bg_get_coarse_monotonic_ms();
+	}
+	double coarse_ms = to_ms(bg_clock() - start);
+
+	LOG_INFO("%llu timestamps\nget_local_date             %.5f ms (%.1f ns/call)\nbg_get_coarse_monotonic_ms %.5f ms (%.1f ns/call)\n",
+		count, date_ms, date_ms * 1e6 / count, coarse_ms, coarse_ms * 1e6 / count);
+	return sum;
+}
+
 int main() {
 
 	char bf16[16]; memset(bf16, 0xcc, bg_sizeof(bf16));
@@ -213,22 +1202,42 @@ int main() {
 	clocks_per_sec = li.QuadPart;
 
 
+	print_cpu_topology();
 	compare_conversion_speed();
+	check_inline_array();
+	compare_array_push_speed();
+	compare_hash_speed();
+	compare_hash_map_speed();
+	compare_spsc_ring_speed();
+	measure_mpmc_queue_throughput();
+	compare_sort_speed();
+	compare_parallel_speed();
+	compare_job_system_speed();
+	compare_lock_contention();
+	compare_wake_latency();
+	compare_counter_contention();
+#if BG_HAS_COROUTINES
+	compare_async_file_io();
+#endif
+	measure_timer_wheel();
+	compare_log_speed();
+	measure_filtered_log();
+	compare_binary_log_speed();
+	compare_timestamp_speed();
 	return 0;
 
 
-	std::vector<std::thread> thread_vector;
-	thread_vector.reserve(100);
+	u64 io_results[THREAD_COUNT * 2] = {};
+	Bg_Job *io_jobs = bg_job_create(NULL, NULL);
 
 	for (u64 i =0; i<THREAD_COUNT; i++) {
-		thread_vector.emplace_back(std::thread(do_async_thing));
-		thread_vector.emplace_back(std::thread(do_sync_thing));
+		bg_job_run(bg_job_create(do_async_job, &io_results[i * 2], io_jobs));
+		bg_job_run(bg_job_create(do_sync_job, &io_results[i * 2 + 1], io_jobs));
 		Sleep(50);
 	}
 
-	for (u64 i = 0; i<thread_vector.size(); i++) {
-		thread_vector[i].join();
-	}
+	bg_job_run(io_jobs);
+	bg_job_wait(io_jobs);
 
 	printf("DONE!!! \n");
 